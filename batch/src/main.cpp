@@ -0,0 +1,163 @@
+#include "vaaacbatch.hpp"
+
+#include <iostream>
+#include <functional>
+
+/*
+ * vaaac parameter sweeps over recorded
+ * clips.
+ *
+ *   batch [--threads n] [--set name=value]... [--sweep name=v1,v2,...]... clip...
+ *
+ * every clip is run once per combination
+ * of the swept values, and one csv line
+ * is written per run
+ */
+
+// settable parameters, by name
+const std::map<std::string, std::function<void(vaaacParams&, double)>> PARAMS = {
+	{ "maskLowTolerance", [](vaaacParams& p, double v) { p.maskLowTolerance = (int)v; } },
+	{ "maskHighTolerance", [](vaaacParams& p, double v) { p.maskHighTolerance = (int)v; } },
+	{ "reticleSize", [](vaaacParams& p, double v) { p.reticleSize = (int)v; } },
+	{ "noAimAreaSize", [](vaaacParams& p, double v) { p.noAimAreaSize = (int)v; } },
+	{ "bfsSampleSize", [](vaaacParams& p, double v) { p.bfsSampleSize = (int)v; } },
+	{ "aimSmoothness", [](vaaacParams& p, double v) { p.aimSmoothness = (int)v; } },
+	{ "triggerMinimumDistance", [](vaaacParams& p, double v) { p.triggerMinimumDistance = v; } },
+	{ "triggerMaximumDistance", [](vaaacParams& p, double v) { p.triggerMaximumDistance = v; } },
+	{ "triggerAllowedYDeviation", [](vaaacParams& p, double v) { p.triggerAllowedYDeviation = v; } },
+	{ "triggerAllowedXDeviation", [](vaaacParams& p, double v) { p.triggerAllowedXDeviation = v; } },
+	{ "backgroundSuppression", [](vaaacParams& p, double v) { p.backgroundSuppression = v != 0.0; } },
+	{ "backgroundLearningShift", [](vaaacParams& p, double v) { p.backgroundLearningShift = (int)v; } },
+	{ "backgroundThreshold", [](vaaacParams& p, double v) { p.backgroundThreshold = (int)v; } },
+	{ "aimEstimator", [](vaaacParams& p, double v) { p.aimEstimator = (int)v; } },
+	{ "fingertipLevels", [](vaaacParams& p, double v) { p.fingertipLevels = (int)v; } }
+};
+
+int usage() {
+	std::cerr << "usage: batch [--threads n] [--set name=value]... [--sweep name=v1,v2,...]... clip..." << std::endl;
+	std::cerr << "parameters:";
+	for (auto& param : PARAMS) {
+		std::cerr << " " << param.first;
+	}
+	std::cerr << std::endl;
+	return 1;
+}
+
+// splits "name=v1,v2,..." into its name and values
+bool parseAssignment(const std::string& arg, std::string& name, std::vector<double>& values) {
+	size_t equals = arg.find('=');
+	if (equals == std::string::npos) {
+		return false;
+	}
+	name = arg.substr(0, equals);
+	if (!PARAMS.count(name)) {
+		return false;
+	}
+	std::istringstream ss(arg.substr(equals + 1));
+	std::string value;
+	for (; std::getline(ss, value, ','); ) {
+		try {
+			values.push_back(std::stod(value));
+		} catch (...) {
+			return false;
+		}
+	}
+	return !values.empty();
+}
+
+int main(int argc, char* argv[]) {
+	int threads = 0;
+	vaaacParams base;
+	std::vector<std::pair<std::string, std::vector<double>>> sweeps;
+	std::vector<std::string> clips;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if ((arg == "--threads" || arg == "--set" || arg == "--sweep") && i + 1 >= argc) {
+			return usage();
+		}
+		if (arg == "--threads") {
+			threads = std::atoi(argv[++i]);
+		} else if (arg == "--set" || arg == "--sweep") {
+			std::string name;
+			std::vector<double> values;
+			if (!parseAssignment(argv[++i], name, values)) {
+				return usage();
+			}
+			if (arg == "--set") {
+				PARAMS.at(name)(base, values[0]);
+			} else {
+				sweeps.push_back({ name, values });
+			}
+		} else {
+			clips.push_back(arg);
+		}
+	}
+	if (clips.empty()) {
+		return usage();
+	}
+
+	// every combination of the swept values
+	std::vector<std::vector<double>> combinations = { {} };
+	for (auto& sweep : sweeps) {
+		std::vector<std::vector<double>> extended;
+		for (auto& combination : combinations) {
+			for (double value : sweep.second) {
+				extended.push_back(combination);
+				extended.back().push_back(value);
+			}
+		}
+		combinations = extended;
+	}
+
+	// one task per clip and combination
+	std::vector<vaaacBatchTask> tasks;
+	std::vector<int> taskCombination;
+	for (int c = 0; c < (int)combinations.size(); ++c) {
+		vaaacParams params = base;
+		for (int s = 0; s < (int)sweeps.size(); ++s) {
+			PARAMS.at(sweeps[s].first)(params, combinations[c][s]);
+		}
+		// out of range values would hang or break the pipeline
+		if (!params.isValid()) {
+			std::cerr << "[-] invalid parameters:";
+			for (int s = 0; s < (int)sweeps.size(); ++s) {
+				std::cerr << " " << sweeps[s].first << "=" << combinations[c][s];
+			}
+			std::cerr << " (or in --set)." << std::endl;
+			return usage();
+		}
+		for (auto& clip : clips) {
+			tasks.push_back({ clip, params });
+			taskCombination.push_back(c);
+		}
+	}
+	std::cerr << "[~] running " << tasks.size() << " tasks." << std::endl;
+	auto begin = std::chrono::steady_clock::now();
+	std::vector<vaaacBatchResult> results = vaaacBatch::run(tasks, threads);
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	std::cerr << "[+] done in " << elapsed << " s." << std::endl;
+
+	// csv report
+	std::cout << "clip";
+	for (auto& sweep : sweeps) {
+		std::cout << "," << sweep.first;
+	}
+	std::cout << ",ok,frames,detectedFrames,triggers,meanUpdateTime,maxUpdateTime,meanVisitedNodes,angleJitter"
+		<< ",meanAngleError,triggerHits,triggerMisses,triggerFalseAlarms" << std::endl;
+	for (int i = 0; i < (int)tasks.size(); ++i) {
+		vaaacBatchResult& r = results[i];
+		std::cout << tasks[i].clip;
+		for (double value : combinations[taskCombination[i]]) {
+			std::cout << "," << value;
+		}
+		std::cout << "," << r.ok << "," << r.frames << "," << r.detectedFrames << "," << r.triggers
+			<< "," << r.meanUpdateTime << "," << r.maxUpdateTime << "," << r.meanVisitedNodes << "," << r.angleJitter;
+		if (r.annotated) {
+			std::cout << "," << r.meanAngleError << "," << r.triggerHits << "," << r.triggerMisses << "," << r.triggerFalseAlarms;
+		} else {
+			std::cout << ",,,,";
+		}
+		std::cout << std::endl;
+	}
+	return 0;
+}
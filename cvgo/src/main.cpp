@@ -1,5 +1,6 @@
 #include "vaaac.hpp"
 #include "memory.h"
+#include "vaaacshm.hpp"
 
 #include <thread>
 
@@ -65,6 +66,10 @@ int main(int argc, char* argv[]) {
 	 * arm angle calculation library!
 	 */
 	vaaac* v = new vaaac();
+	std::cout << "[+] capture interval: " << v->getCaptureInterval() << " ms, jitter: " << v->getCaptureJitter() << " ms." << std::endl;
+	if (v->isCalibrationIgnored()) {
+		std::cout << "[-] the camera calibration file has another aspect ratio than the capture mode, using the field of view instead." << std::endl;
+	}
 
 	/*
 	 * skin tone calibration is required
@@ -73,6 +78,19 @@ int main(int argc, char* argv[]) {
 	 */
 	v->calibrateSkinTone();
 
+	/*
+	 * publish results to shared memory
+	 * for other processes to read
+	 */
+	vaaacShmPublisher* shm = nullptr;
+	if (v->isOk()) {
+		shm = new vaaacShmPublisher(v->getResolution(), v->getResolution());
+		if (!shm->isOk()) {
+			std::cout << "[-] shared memory block unavailable (is another instance publishing?), results won't be published." << std::endl;
+		}
+	}
+	uint32_t updates = 0;
+
 	// get initial angle view, so that
 	// it doesn't reset to zero
 	vec3f initialAngles = mem->read<vec3f>(dwClientState + viewAnglesOffset);
@@ -80,7 +98,24 @@ int main(int argc, char* argv[]) {
 	float smoothness = 5.0;
 	for (; v->isOk(); ) {
 		// new frame
+		auto updateBegin = std::chrono::steady_clock::now();
 		v->update();
+		double updateTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - updateBegin).count();
+
+		// publish
+		vaaacShmState state;
+		state.update = ++updates;
+		state.detected = v->isDetected();
+		state.triggered = v->isTriggered();
+		state.visitedNodes = v->getVisitedNodes();
+		state.xAngle = v->getXAngle();
+		state.yAngle = v->getYAngle();
+		state.updateTime = updateTime;
+		state.captureInterval = v->getCaptureInterval();
+		state.captureJitter = v->getCaptureJitter();
+		shm->publishState(state);
+		cv::Mat frame = v->getFrame();
+		shm->publishFrame(frame.data, frame.step);
 
 		// change angles
 		double angleX = initialAngles.y + v->getXAngle();
@@ -111,6 +146,7 @@ int main(int argc, char* argv[]) {
 			break;
 		}
 	}
+	delete shm;
 	delete v;
 	delete mem;
 	return 0;
@@ -142,6 +142,158 @@ const double TRIGGER_ALLOWED_Y_DEVIATION = 3.0;
  */
 const double TRIGGER_ALLOWED_X_DEVIATION = 2.0;
 
+/*
+ * this indicates whether to probe the
+ * camera's capture modes on startup
+ * instead of using whatever default
+ * mode the driver picks.
+ * the fastest mode that meets the
+ * 'CAPTURE_AIM_PRECISION' target is
+ * chosen
+ */
+const bool NEGOTIATE_CAPTURE_MODE = true;
+
+/*
+ * minimum side length, in pixels, of
+ * the square viewport used to compute
+ * the aim point.
+ * among the modes that meet it, the
+ * smallest one is preferred, since
+ * every extra pixel is extra work per
+ * frame.
+ * the sizes above ('RETICLE_SIZE',
+ * 'NO_AIM_AREA_SIZE', 'BFS_SAMPLE_SIZE',
+ * the sample area...) are in pixels and
+ * are not rescaled to the negotiated
+ * mode, so this defaults to the 480 px
+ * viewport of the usual 640x480 default
+ * mode they were tuned for. lower it only
+ * along with them
+ */
+const int CAPTURE_AIM_PRECISION = 480;
+
+/*
+ * number of frames grabbed in order to
+ * measure the capture interval and
+ * jitter of a capture mode.
+ * also, the number of modes, fastest
+ * first, that get measured before
+ * picking one, since the frame rate
+ * reported by some drivers is not the
+ * one they deliver
+ */
+const int CAPTURE_PROBE_FRAMES = 30;
+const int CAPTURE_PROBE_MODES = 3;
+
+/*
+ * this indicates whether to map the aim
+ * point to angles through the camera's
+ * intrinsics and lens distortion.
+ * when false, the aim point is mapped
+ * linearly from the center of the
+ * viewport (0) to its edges (90).
+ * either way, the mapping is baked into
+ * a per-pixel lookup table on startup
+ */
+const bool CALIBRATED_ANGLE_MAPPING = true;
+
+/*
+ * path to an opencv calibration file,
+ * such as the ones written by opencv's
+ * calibration sample, containing the
+ * 'camera_matrix' and
+ * 'distortion_coefficients' nodes.
+ * if it's empty, can't be read, or was
+ * made at another aspect ratio than the
+ * capture mode's, the
+ * 'CAMERA_FIELD_OF_VIEW' and
+ * 'CAMERA_DISTORTION' constants are used
+ * instead
+ */
+const char* const CAMERA_CALIBRATION_FILE = "";
+
+/*
+ * horizontal field of view of the
+ * camera, in degrees
+ */
+const double CAMERA_FIELD_OF_VIEW = 60.0;
+
+/*
+ * lens distortion coefficients, in
+ * opencv's order: k1, k2, p1, p2, k3
+ */
+const double CAMERA_DISTORTION[5] = { 0.0, 0.0, 0.0, 0.0, 0.0 };
+
+/*
+ * this indicates whether to suppress
+ * static skin colored objects in the
+ * room (furniture, walls, faces in
+ * photos...) before looking for the
+ * user's arm.
+ * it adds a step to the calibration in
+ * which the user has to move out of
+ * the camera's view
+ */
+const bool BACKGROUND_SUPPRESSION = false;
+
+/*
+ * number of frames used to learn the
+ * background during calibration
+ */
+const int BACKGROUND_LEARNING_FRAMES = 60;
+
+/*
+ * after calibration, the background
+ * keeps being learned outside of the
+ * user's arm at a rate of
+ * 1 / 2^BACKGROUND_LEARNING_SHIFT per
+ * frame.
+ * the higher this number, the slower
+ * new objects become background.
+ * it must be between 1 and 8
+ */
+const int BACKGROUND_LEARNING_SHIFT = 6;
+
+/*
+ * a pixel is considered background
+ * when it has been skin colored for at
+ * least this fraction (out of 255) of
+ * the recent frames.
+ * it must be between 1 and 255
+ */
+const int BACKGROUND_THRESHOLD = 128;
+
+/*
+ * how the aim point is picked out of
+ * the object found by the bfs:
+ * - AIM_LAST_VISITED: the last node the
+ *   bfs visited. depends on the order of
+ *   the queue
+ * - AIM_GEODESIC_EXTREME: the centroid of
+ *   the tip around the node furthest away
+ *   from the reticle, walking along the
+ *   object. doesn't depend on the order
+ *   of the queue and has sub-pixel
+ *   precision
+ */
+const int AIM_LAST_VISITED = 0;
+const int AIM_GEODESIC_EXTREME = 1;
+const int AIM_ESTIMATOR = AIM_GEODESIC_EXTREME;
+
+/*
+ * number of bfs levels, counting from
+ * the furthest one, that make up the tip
+ * averaged by AIM_GEODESIC_EXTREME. only
+ * the nodes connected to the furthest
+ * node through these levels count, so
+ * other fingers the same distance away
+ * don't pull the aim point off.
+ * the higher this number, the less
+ * jitter, but the further the aim point
+ * falls behind the fingertip
+ */
+const int FINGERTIP_LEVELS = 2;
+
 //                                 //
 //--------  v  a  a  a  c  --------//
 //                                 //
@@ -152,11 +304,64 @@ const double TRIGGER_ALLOWED_X_DEVIATION = 2.0;
 #include <utility>
 #include <queue>
 #include <deque>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
 
 #include <opencv2/videoio.hpp>
 #include <opencv2/highgui.hpp>
 #include <opencv2/opencv.hpp>
 
+/*
+ * runtime copy of the tunable constants
+ * above, so that several pipelines with
+ * different settings can run in the
+ * same process, like the parameter
+ * sweeps in 'vaaacbatch.hpp'.
+ * every member defaults to the value of
+ * its constant
+ */
+struct vaaacParams {
+	bool renderToFrame = RENDER_TO_FRAME;
+	bool renderToWindow = RENDER_TO_WINDOW;
+	int maskLowTolerance = MASK_LOW_TOLERANCE;
+	int maskHighTolerance = MASK_HIGH_TOLERANCE;
+	int reticleSize = RETICLE_SIZE;
+	int noAimAreaSize = NO_AIM_AREA_SIZE;
+	int bfsSampleSize = BFS_SAMPLE_SIZE;
+	int aimSmoothness = AIM_SMOOTHNESS;
+	double triggerMinimumDistance = TRIGGER_MINIMUM_DISTANCE;
+	double triggerMaximumDistance = TRIGGER_MAXIMUM_DISTANCE;
+	double triggerAllowedYDeviation = TRIGGER_ALLOWED_Y_DEVIATION;
+	double triggerAllowedXDeviation = TRIGGER_ALLOWED_X_DEVIATION;
+	bool backgroundSuppression = BACKGROUND_SUPPRESSION;
+	int backgroundLearningShift = BACKGROUND_LEARNING_SHIFT;
+	int backgroundThreshold = BACKGROUND_THRESHOLD;
+	int aimEstimator = AIM_ESTIMATOR;
+	int fingertipLevels = FINGERTIP_LEVELS;
+
+	// whether the pipeline can run with these settings
+	bool isValid() const {
+		return maskLowTolerance >= 0 && maskLowTolerance <= 255
+			&& maskHighTolerance >= 0 && maskHighTolerance <= 255
+			&& reticleSize >= 1
+			&& noAimAreaSize >= 0
+			&& bfsSampleSize >= 1
+			&& aimSmoothness >= 1
+			&& triggerMinimumDistance >= 0.0 && triggerMinimumDistance <= triggerMaximumDistance
+			&& triggerAllowedYDeviation >= 0.0 && triggerAllowedXDeviation >= 0.0
+			&& backgroundLearningShift >= 1 && backgroundLearningShift <= 8
+			&& backgroundThreshold >= 1 && backgroundThreshold <= 255
+			&& (aimEstimator == AIM_LAST_VISITED || aimEstimator == AIM_GEODESIC_EXTREME)
+			&& fingertipLevels >= 1;
+	}
+
+	// whether the pixel sizes fit in a square viewport of side 'res'
+	bool fits(int res) const {
+		return reticleSize <= res && noAimAreaSize <= res && bfsSampleSize <= res;
+	}
+};
+
 class vaaac {
 
 	private:
@@ -164,6 +369,9 @@ class vaaac {
 		// is everything working
 		int ok;
 
+		// tunable settings
+		vaaacParams params;
+
 		// player detected
 		bool detected;
 
@@ -181,6 +389,19 @@ class vaaac {
 		cv::Mat frame;
 		cv::Mat mask;
 
+		/*
+		 * background model: running average of
+		 * the skin mask (0 - 255, in fixed point
+		 * with 8 fractional bits) and the bounds
+		 * of the object found in the last frame,
+		 * which are not learned from
+		 */
+		cv::Mat background;
+		cv::Rect objectBounds;
+
+		// bfs nodes visited in the last frame
+		int visitedNodes;
+
 		// skin tone hsv color bounds
 		int hLow;
 		int hHigh;
@@ -210,6 +431,348 @@ class vaaac {
 		int TRIGGER_ALLOWED_X_DEVIATION_PIXELS;
 		std::vector<std::pair<int, int>> yxDelta;
 
+		/*
+		 * bfs level of every node, -1 if not
+		 * visited yet and -2 if not part of the
+		 * object. allocated once, and only the
+		 * nodes visited in a frame are reset
+		 * after it
+		 */
+		cv::Mat_<int> bfsLevels;
+		std::vector<std::pair<int, int>> bfsVisited;
+
+		// per-pixel angle lookup tables
+		cv::Mat_<float> xAngleLut;
+		cv::Mat_<float> yAngleLut;
+
+		/*
+		 * whether the calibration file was left
+		 * out because it was made at another
+		 * aspect ratio
+		 */
+		bool calibrationIgnored;
+
+		// capture timing (milliseconds)
+		double captureInterval;
+		double captureJitter;
+
+		/*
+		 * grabs 'frames' frames and measures
+		 * the mean interval between them and
+		 * its standard deviation.
+		 * grab() is used so that no decoding
+		 * time gets into the measurement
+		 */
+		void measureCapture(int frames, double& interval, double& jitter) {
+			interval = 0.0;
+			jitter = 0.0;
+			// let the driver settle after a mode change
+			videoCapture.grab();
+			videoCapture.grab();
+			std::vector<double> deltas;
+			auto last = std::chrono::steady_clock::now();
+			for (int i = 0; i < frames; ++i) {
+				if (!videoCapture.grab()) {
+					break;
+				}
+				auto now = std::chrono::steady_clock::now();
+				deltas.push_back(std::chrono::duration<double, std::milli>(now - last).count());
+				last = now;
+			}
+			if (deltas.empty()) {
+				return;
+			}
+			for (double d : deltas) {
+				interval += d;
+			}
+			interval /= deltas.size();
+			for (double d : deltas) {
+				jitter += (d - interval) * (d - interval);
+			}
+			jitter = std::sqrt(jitter / deltas.size());
+		}
+
+		/*
+		 * opencv can't enumerate the modes a
+		 * camera supports, so a table of the
+		 * usual ones is requested one by one
+		 * and the driver's answer read back.
+		 * the modes that meet the precision
+		 * target are sorted by frame rate,
+		 * then by size, and the best few get
+		 * measured for real
+		 */
+		void negotiateCaptureMode() {
+			static const int modes[][3] = {
+				{ 320, 240, 120 }, { 320, 240, 60 }, { 320, 240, 30 },
+				{ 640, 480, 120 }, { 640, 480, 90 }, { 640, 480, 60 }, { 640, 480, 30 },
+				{ 800, 600, 60 }, { 800, 600, 30 },
+				{ 1280, 720, 120 }, { 1280, 720, 60 }, { 1280, 720, 30 },
+				{ 1920, 1080, 60 }, { 1920, 1080, 30 }
+			};
+			// driver default, in case no mode is good enough
+			double defaultWidth = videoCapture.get(cv::CAP_PROP_FRAME_WIDTH);
+			double defaultHeight = videoCapture.get(cv::CAP_PROP_FRAME_HEIGHT);
+			double defaultFps = videoCapture.get(cv::CAP_PROP_FPS);
+			// { fps, area, width, height }
+			std::vector<std::vector<double>> accepted;
+			for (auto& mode : modes) {
+				videoCapture.set(cv::CAP_PROP_FRAME_WIDTH, mode[0]);
+				videoCapture.set(cv::CAP_PROP_FRAME_HEIGHT, mode[1]);
+				videoCapture.set(cv::CAP_PROP_FPS, mode[2]);
+				int w = videoCapture.get(cv::CAP_PROP_FRAME_WIDTH);
+				int h = videoCapture.get(cv::CAP_PROP_FRAME_HEIGHT);
+				double fps = videoCapture.get(cv::CAP_PROP_FPS);
+				if (std::min(w, h) < CAPTURE_AIM_PRECISION) {
+					continue;
+				}
+				bool duplicate = false;
+				for (auto& a : accepted) {
+					duplicate |= a[2] == w && a[3] == h && a[0] == fps;
+				}
+				if (!duplicate) {
+					accepted.push_back({ fps, (double)w * h, (double)w, (double)h });
+				}
+			}
+			if (accepted.empty()) {
+				videoCapture.set(cv::CAP_PROP_FRAME_WIDTH, defaultWidth);
+				videoCapture.set(cv::CAP_PROP_FRAME_HEIGHT, defaultHeight);
+				videoCapture.set(cv::CAP_PROP_FPS, defaultFps);
+				return;
+			}
+			std::sort(accepted.begin(), accepted.end(), [](const std::vector<double>& a, const std::vector<double>& b) {
+				return a[0] != b[0] ? a[0] > b[0] : a[1] < b[1];
+			});
+			// measure the best candidates and keep the fastest one
+			int best = 0;
+			double bestInterval = 0.0;
+			int probes = std::min((int)accepted.size(), CAPTURE_PROBE_MODES);
+			for (int i = 0; i < probes; ++i) {
+				videoCapture.set(cv::CAP_PROP_FRAME_WIDTH, accepted[i][2]);
+				videoCapture.set(cv::CAP_PROP_FRAME_HEIGHT, accepted[i][3]);
+				videoCapture.set(cv::CAP_PROP_FPS, accepted[i][0]);
+				double interval, jitter;
+				measureCapture(CAPTURE_PROBE_FRAMES, interval, jitter);
+				if (interval > 0.0 && (bestInterval == 0.0 || interval < bestInterval)) {
+					best = i;
+					bestInterval = interval;
+				}
+			}
+			videoCapture.set(cv::CAP_PROP_FRAME_WIDTH, accepted[best][2]);
+			videoCapture.set(cv::CAP_PROP_FRAME_HEIGHT, accepted[best][3]);
+			videoCapture.set(cv::CAP_PROP_FPS, accepted[best][0]);
+		}
+
+		// skin tone binarization of 'frame'
+		void makeMask() {
+			cv::cvtColor(frame, mask, cv::COLOR_BGR2HSV);
+			cv::inRange(mask, cv::Scalar(hLow, sLow, vLow), cv::Scalar(hHigh, sHigh, vHigh), mask);
+		}
+
+		/*
+		 * removes the background from the mask
+		 * and updates the background model in
+		 * the same pass over the image.
+		 * pixels inside the object found in the
+		 * last frame are not learned from, so
+		 * that an arm held still doesn't fade
+		 * into the background.
+		 * the fractional bits and the rounded
+		 * step let the average get within half
+		 * a unit of 0 and 255 for every shift
+		 * up to 8
+		 */
+		void suppressBackground() {
+			int shift = params.backgroundLearningShift;
+			int half = 1 << (shift - 1);
+			for (int y = 0; y < res; ++y) {
+				uchar* m = mask.ptr<uchar>(y);
+				ushort* b = background.ptr<ushort>(y);
+				bool rowInObject = y >= objectBounds.y && y < objectBounds.y + objectBounds.height;
+				for (int x = 0; x < res; ++x) {
+					int skin = m[x];
+					if (!rowInObject || x < objectBounds.x || x >= objectBounds.x + objectBounds.width) {
+						int delta = (skin << 8) - b[x];
+						b[x] += (delta + (delta > 0 ? half : -half)) / (1 << shift);
+					}
+					m[x] = skin && ((b[x] + 128) >> 8) < params.backgroundThreshold ? 255 : 0;
+				}
+			}
+		}
+
+		/*
+		 * bakes the pixel to angle mapping of
+		 * the viewport into 'xAngleLut' and
+		 * 'yAngleLut', so that update() only
+		 * needs a lookup per frame.
+		 * the calibrated mapping undistorts
+		 * every pixel into a viewing ray and
+		 * takes its azimuth and elevation,
+		 * scaled so that the viewport's edges
+		 * stay at 90 degrees
+		 */
+		void buildAngleLut() {
+			xAngleLut.create(res, res);
+			yAngleLut.create(res, res);
+			calibrationIgnored = false;
+			if (!CALIBRATED_ANGLE_MAPPING) {
+				for (int y = 0; y < res; ++y) {
+					for (int x = 0; x < res; ++x) {
+						yAngleLut(y, x) = -(float)(halfRes - y) / halfRes * 90.0f;
+						xAngleLut(y, x) = -(float)(halfRes - x) / halfRes * 90.0f;
+					}
+				}
+				return;
+			}
+			// camera intrinsics
+			cv::Mat cameraMatrix, distortion;
+			cv::FileStorage fs;
+			if (CAMERA_CALIBRATION_FILE[0] && fs.open(CAMERA_CALIBRATION_FILE, cv::FileStorage::READ)) {
+				fs["camera_matrix"] >> cameraMatrix;
+				fs["distortion_coefficients"] >> distortion;
+				/*
+				 * the calibration may have been done at
+				 * another resolution. the same aspect
+				 * ratio only needs rescaling, but another
+				 * one means the sensor was cropped
+				 * differently, and the intrinsics don't
+				 * apply anymore
+				 */
+				int calibrationWidth = 0, calibrationHeight = 0;
+				fs["image_width"] >> calibrationWidth;
+				fs["image_height"] >> calibrationHeight;
+				if (!cameraMatrix.empty() && calibrationWidth > 0 && calibrationHeight > 0
+					&& (calibrationWidth != width || calibrationHeight != height)) {
+					if ((long long)calibrationWidth * height != (long long)width * calibrationHeight) {
+						cameraMatrix.release();
+						calibrationIgnored = true;
+					} else {
+						cameraMatrix.convertTo(cameraMatrix, CV_64F);
+						cv::Mat xRow = cameraMatrix.row(0), yRow = cameraMatrix.row(1);
+						xRow *= (double)width / calibrationWidth;
+						yRow *= (double)height / calibrationHeight;
+					}
+				}
+			}
+			if (cameraMatrix.empty()) {
+				double f = (width / 2.0) / std::tan(CAMERA_FIELD_OF_VIEW * CV_PI / 360.0);
+				cameraMatrix = (cv::Mat_<double>(3, 3) << f, 0, width / 2.0, 0, f, height / 2.0, 0, 0, 1);
+				distortion = cv::Mat(1, 5, CV_64F, (void*)CAMERA_DISTORTION).clone();
+			}
+			// undistort every viewport pixel into normalized coordinates
+			std::vector<cv::Point2f> pixels, rays;
+			pixels.reserve(res * res);
+			for (int y = 0; y < res; ++y) {
+				for (int x = 0; x < res; ++x) {
+					pixels.push_back(cv::Point2f(x + frameBounds.x, y + frameBounds.y));
+				}
+			}
+			cv::undistortPoints(pixels, rays, cameraMatrix, distortion);
+			for (int y = 0; y < res; ++y) {
+				for (int x = 0; x < res; ++x) {
+					cv::Point2f& ray = rays[y * res + x];
+					xAngleLut(y, x) = std::atan2(ray.x, 1.0f);
+					yAngleLut(y, x) = std::atan2(ray.y, std::sqrt(1.0f + ray.x * ray.x));
+				}
+			}
+			// scale by the angles found at the middle of the viewport's edges
+			float xScale = 90.0f / std::max(std::abs(xAngleLut(halfRes, 0)), std::abs(xAngleLut(halfRes, res - 1)));
+			float yScale = 90.0f / std::max(std::abs(yAngleLut(0, halfRes)), std::abs(yAngleLut(res - 1, halfRes)));
+			xAngleLut *= xScale;
+			yAngleLut *= yScale;
+		}
+
+		/*
+		 * computes everything that depends on
+		 * the frame size ('width' and 'height')
+		 * and resets the tracking state
+		 */
+		void setup() {
+			detected = false;
+			triggered = false;
+			xAngle = 0.0;
+			yAngle = 0.0;
+			xAngleSmooth = 0.0;
+			yAngleSmooth = 0.0;
+			visitedNodes = 0;
+			objectBounds = cv::Rect();
+			// resolution (1:1 aspect ratio)
+			res = std::min(width, height);
+			halfRes = res / 2;
+			// make the viewport a centered square
+			int addX = 0, addY = 0;
+			if (width > height) {
+				addX = (width - height) / 2;
+			}
+			else if (height > width) {
+				addY = (height - width) / 2;
+			}
+			// limit camera resolution ratio to 1:1
+			frameBounds = cv::Rect(addX, addY, res, res);
+			// determine reticle view area
+			int reticlePos = halfRes - params.reticleSize / 2;
+			reticleBounds = cv::Rect(reticlePos, reticlePos, params.reticleSize, params.reticleSize);
+			// determine no aim zone
+			int noAimAreaPos = halfRes - params.noAimAreaSize / 2;
+			noAimAreaBounds = cv::Rect(noAimAreaPos, noAimAreaPos, params.noAimAreaSize, params.noAimAreaSize);
+			// fill up bfs offsets array
+			bfsOffsets.clear();
+			for (int i = -1; i < 2; ++i) {
+				for (int j = -1; j < 2; ++j) {
+					bfsOffsets.push_back(std::make_pair<int, int>(i * params.bfsSampleSize, j * params.bfsSampleSize));
+				}
+			}
+			// bfs node levels, all unvisited
+			bfsLevels = cv::Mat_<int>(res + 1, res + 1, -1);
+			bfsVisited.clear();
+			// precompute trigger system constants
+			TRIGGER_MINIMUM_DISTANCE_PIXELS = params.triggerMinimumDistance * res / 100.0;
+			TRIGGER_MAXIMUM_DISTANCE_PIXELS = params.triggerMaximumDistance * res / 100.0;
+			TRIGGER_ALLOWED_Y_DEVIATION_PIXELS = params.triggerAllowedYDeviation * res / 100.0;
+			TRIGGER_ALLOWED_X_DEVIATION_PIXELS = params.triggerAllowedXDeviation * res / 100.0;
+			// precompute pixel to angle mapping
+			buildAngleLut();
+			// clear y variance deque
+			increment = true;
+			yxDeltaSize = 0;
+			yxDelta.clear();
+		}
+
+		// center of the viewport, where the skin tone gets sampled
+		cv::Rect skinSampleArea() {
+			int xCoord = res / 2 - SAMPLE_AREA_WIDTH / 2;
+			int yCoord = res / 2 - SAMPLE_AREA_HEIGHT / 2;
+			int rectSizeX = std::min(SAMPLE_AREA_WIDTH, halfRes);
+			int rectSizeY = std::min(SAMPLE_AREA_HEIGHT, halfRes);
+			return cv::Rect(xCoord, yCoord, rectSizeX, rectSizeY);
+		}
+
+		// skin tone bounds from the sample area of 'frame'
+		void sampleSkinTone() {
+			cv::Mat hsv;
+			cv::cvtColor(frame, hsv, cv::COLOR_BGR2HSV);
+			cv::Mat sample(hsv, skinSampleArea());
+			cv::Scalar mean = cv::mean(sample);
+			hLow = mean[0] - params.maskLowTolerance;
+			hHigh = mean[0] + params.maskHighTolerance;
+			sLow = mean[1] - params.maskLowTolerance;
+			sHigh = mean[1] + params.maskHighTolerance;
+			vLow = 0;
+			vHigh = 255;
+		}
+
+		// bilinear lookup, for sub-pixel aim points
+		float lookupAngle(const cv::Mat_<float>& lut, double x, double y) {
+			x = std::min(std::max(x, 0.0), res - 1.0);
+			y = std::min(std::max(y, 0.0), res - 1.0);
+			int x0 = (int)x, y0 = (int)y;
+			int x1 = std::min(x0 + 1, res - 1), y1 = std::min(y0 + 1, res - 1);
+			float fx = (float)(x - x0), fy = (float)(y - y0);
+			float top = lut(y0, x0) + (lut(y0, x1) - lut(y0, x0)) * fx;
+			float bottom = lut(y1, x0) + (lut(y1, x1) - lut(y1, x0)) * fx;
+			return top + (bottom - top) * fy;
+		}
+
 	public:
 
 		inline bool isOk() {
@@ -232,11 +795,48 @@ class vaaac {
 			return yAngleSmooth;
 		}
 
+		// angles of the last frame, before smoothing
+		inline double getRawXAngle() {
+			return xAngle;
+		}
+
+		inline double getRawYAngle() {
+			return yAngle;
+		}
+
 		inline cv::Mat getFrame() {
 			return frame;
 		}
 
-		vaaac() {
+		inline int getResolution() {
+			return res;
+		}
+
+		inline double getCaptureInterval() {
+			return captureInterval;
+		}
+
+		inline double getCaptureJitter() {
+			return captureJitter;
+		}
+
+		inline bool isCalibrationIgnored() {
+			return calibrationIgnored;
+		}
+
+		inline int getVisitedNodes() {
+			return visitedNodes;
+		}
+
+		vaaac(vaaacParams params = vaaacParams()) : params(params) {
+			captureInterval = 0.0;
+			captureJitter = 0.0;
+			calibrationIgnored = false;
+			// check the settings
+			ok = params.isValid();
+			if (!ok) {
+				return;
+			}
 			// webcam initialization
 			videoCapture = cv::VideoCapture(0);
 			videoCapture.set(cv::CAP_PROP_SETTINGS, 1);
@@ -246,54 +846,53 @@ class vaaac {
 				ok = false;
 				return;
 			}
-			// resolution (1:1 aspect ratio)
+			// don't let the driver queue up stale frames
+			videoCapture.set(cv::CAP_PROP_BUFFERSIZE, 1);
+			// pick the lowest latency capture mode
+			if (NEGOTIATE_CAPTURE_MODE) {
+				negotiateCaptureMode();
+			}
+			measureCapture(CAPTURE_PROBE_FRAMES, captureInterval, captureJitter);
+			// camera resolution
 			width = videoCapture.get(cv::CAP_PROP_FRAME_WIDTH);
 			height = videoCapture.get(cv::CAP_PROP_FRAME_HEIGHT);
-			res = std::min(width, height);
-			halfRes = res / 2;
-			// make the viewport a centered square
-			int addX = 0, addY = 0;
-			if (width > height) {
-				addX = (width - height) / 2;
+			ok = params.fits(std::min(width, height));
+			if (!ok) {
+				return;
 			}
-			else if (height > width) {
-				addY = (height - width) / 2;
+			setup();
+		}
+
+		/*
+		 * offline pipeline: no camera is opened
+		 * and frames of the given size are fed
+		 * through 'update(input)'.
+		 * the skin tone has to be sampled with
+		 * 'calibrateSkinTone(input)', and the
+		 * background, if suppressed, is learned
+		 * on the fly
+		 */
+		vaaac(int width, int height, vaaacParams params = vaaacParams()) : params(params) {
+			captureInterval = 0.0;
+			captureJitter = 0.0;
+			calibrationIgnored = false;
+			ok = params.isValid() && params.fits(std::min(width, height));
+			if (!ok) {
+				return;
 			}
-			// limit camera resolution ratio to 1:1
-			frameBounds = cv::Rect(addX, addY, res, res);
-			// determine reticle view area
-			int reticlePos = halfRes - RETICLE_SIZE / 2;
-			reticleBounds = cv::Rect(reticlePos, reticlePos, RETICLE_SIZE, RETICLE_SIZE);
-			// determine no aim zone
-			int noAimAreaPos = halfRes - NO_AIM_AREA_SIZE / 2;
-			noAimAreaBounds = cv::Rect(noAimAreaPos, noAimAreaPos, NO_AIM_AREA_SIZE, NO_AIM_AREA_SIZE);
-			// fill up bfs offsets array
-			bfsOffsets.clear();
-			for (int i = -1; i < 2; ++i) {
-				for (int j = -1; j < 2; ++j) {
-					bfsOffsets.push_back(std::make_pair<int, int>(i * BFS_SAMPLE_SIZE, j * BFS_SAMPLE_SIZE));
-				}
+			this->width = width;
+			this->height = height;
+			setup();
+			if (params.backgroundSuppression) {
+				background = cv::Mat::zeros(res, res, CV_16U);
 			}
-			// precompute trigger system constants
-			TRIGGER_MINIMUM_DISTANCE_PIXELS = TRIGGER_MINIMUM_DISTANCE * res / 100.0;
-			TRIGGER_MAXIMUM_DISTANCE_PIXELS = TRIGGER_MAXIMUM_DISTANCE * res / 100.0;
-			TRIGGER_ALLOWED_Y_DEVIATION_PIXELS = TRIGGER_ALLOWED_Y_DEVIATION * res / 100.0;
-			TRIGGER_ALLOWED_X_DEVIATION_PIXELS = TRIGGER_ALLOWED_X_DEVIATION * res / 100.0;
-			// clear y variance deque
-			increment = true;
-			yxDeltaSize = 0;
-			yxDelta.clear();
 		}
 
 		~vaaac() {}
 
 		void calibrateSkinTone() {
 			if (ok & 1) {
-				int xCoord = res / 2 - SAMPLE_AREA_WIDTH / 2;
-				int yCoord = res / 2 - SAMPLE_AREA_HEIGHT / 2;
-				int rectSizeX = std::min(SAMPLE_AREA_WIDTH, halfRes);
-				int rectSizeY = std::min(SAMPLE_AREA_HEIGHT, halfRes);
-				cv::Rect area(xCoord, yCoord, rectSizeX, rectSizeY);
+				cv::Rect area = skinSampleArea();
 				for (;;) {
 					videoCapture >> frame;
 					frame = frame(frameBounds);
@@ -326,29 +925,113 @@ class vaaac {
 						break;
 					}
 					// now draw rectangle and draw
-					if (RENDER_TO_WINDOW) {
+					if (params.renderToWindow) {
 						cv::rectangle(frame, area, cv::Scalar(255, 255, 255), 2);
 						cv::imshow("calibrateSkinTone", frame);
 					}
 				}
-				if (RENDER_TO_WINDOW) {
+				if (params.renderToWindow) {
 					cv::destroyWindow("calibrateSkinTone");
 				}
-				cv::Mat hsv;
-				cv::cvtColor(frame, hsv, cv::COLOR_BGR2HSV);
-				cv::Mat sample(hsv, area);
-				cv::Scalar mean = cv::mean(sample);
-				hLow = mean[0] - MASK_LOW_TOLERANCE;
-				hHigh = mean[0] + MASK_HIGH_TOLERANCE;
-				sLow = mean[1] - MASK_LOW_TOLERANCE;
-				sHigh = mean[1] + MASK_HIGH_TOLERANCE;
-				vLow = 0;
-				vHigh = 255;
+				sampleSkinTone();
+				if (params.backgroundSuppression) {
+					calibrateBackground();
+				}
+				ok = 2;
+			}
+		}
+
+		/*
+		 * non interactive calibration: samples
+		 * the skin tone from the center of the
+		 * given frame
+		 */
+		void calibrateSkinTone(const cv::Mat& input) {
+			if (ok & 1) {
+				frame = input(frameBounds);
+				sampleSkinTone();
 				ok = 2;
 			}
 		}
 
+		/*
+		 * learns which pixels are skin colored
+		 * while the user is out of view.
+		 * requires the skin tone to be known
+		 */
+		void calibrateBackground() {
+			if (ok & 1) {
+				for (;;) {
+					videoCapture >> frame;
+					frame = frame(frameBounds);
+					if (RENDER_SAMPLE_TEXT) {
+						cv::putText(
+								frame,
+								"move out of the camera's view.",
+								cv::Point(10, halfRes - 60),
+								cv::FONT_HERSHEY_DUPLEX,
+								1.0,
+								cv::Scalar(255, 255, 255),
+								1);
+						cv::putText(
+								frame,
+								"then press any key.",
+								cv::Point(10, halfRes - 20),
+								cv::FONT_HERSHEY_DUPLEX,
+								1.0,
+								cv::Scalar(255, 255, 255),
+								1);
+					}
+					int key = cv::waitKey(1);
+					if (key != -1) {
+						break;
+					}
+					if (params.renderToWindow) {
+						cv::imshow("calibrateBackground", frame);
+					}
+				}
+				if (params.renderToWindow) {
+					cv::destroyWindow("calibrateBackground");
+				}
+				cv::Mat sum = cv::Mat::zeros(res, res, CV_32F);
+				for (int i = 0; i < BACKGROUND_LEARNING_FRAMES; ++i) {
+					videoCapture >> frame;
+					frame = frame(frameBounds);
+					makeMask();
+					cv::accumulate(mask, sum);
+				}
+				sum.convertTo(background, CV_16U, 256.0 / BACKGROUND_LEARNING_FRAMES);
+				objectBounds = cv::Rect();
+			}
+		}
+
 		void update() {
+			// get current frame
+			videoCapture >> frame;
+			// reshape
+			frame = frame(frameBounds);
+			process();
+		}
+
+		/*
+		 * processes a frame that didn't come
+		 * from the camera.
+		 * when rendering, the viewport is copied
+		 * so that 'input' is left untouched
+		 */
+		void update(const cv::Mat& input) {
+			if (params.renderToFrame) {
+				input(frameBounds).copyTo(frame);
+			} else {
+				frame = input(frameBounds);
+			}
+			process();
+		}
+
+	private:
+
+		// runs the pipeline on the viewport in 'frame'
+		void process() {
 
 			//                                    //
 			//-- i m a g e  p r o c e s s i n g --//
@@ -357,14 +1040,12 @@ class vaaac {
 			// always false before processing
 			detected = false;
 			triggered = false;
-			// get current frame
-			videoCapture >> frame;
-			// reshape
-			frame = frame(frameBounds);
-			// to hsv
-			cv::cvtColor(frame, mask, cv::COLOR_BGR2HSV);
-			// binarization
-			cv::inRange(mask, cv::Scalar(hLow, sLow, vLow), cv::Scalar(hHigh, sHigh, vHigh), mask);
+			// to hsv and binarization
+			makeMask();
+			// static skin colored objects
+			if (params.backgroundSuppression && !background.empty()) {
+				suppressBackground();
+			}
 			// noise reduction
 			cv::Mat structuringElement = cv::getStructuringElement(cv::MORPH_ELLIPSE, { 3, 3 });
 			cv::morphologyEx(mask, mask, cv::MORPH_OPEN, structuringElement);
@@ -379,14 +1060,17 @@ class vaaac {
 			int yMax = reticleBounds.y + reticleBounds.height;
 			int xAim = halfRes;
 			int yAim = halfRes;
+			double xAimSubpixel = halfRes;
+			double yAimSubpixel = halfRes;
 			xAngle = -100.0;
 			yAngle = -100.0;
+			visitedNodes = 0;
+			objectBounds = cv::Rect();
 			if (cv::mean(mask(reticleBounds))[0] > 0) {
 				detected = true;
-				std::vector<std::vector<bool>> visited(res + 1, std::vector<bool>(res + 1, false));
 				std::queue<std::pair<int, int>> q;
-				for (int i = halfRes - RETICLE_SIZE / 2; i <= halfRes + RETICLE_SIZE / 2; i += BFS_SAMPLE_SIZE) {
-					for (int j = halfRes - RETICLE_SIZE / 2; j <= halfRes + RETICLE_SIZE / 2; j += BFS_SAMPLE_SIZE) {
+				for (int i = halfRes - params.reticleSize / 2; i <= halfRes + params.reticleSize / 2; i += params.bfsSampleSize) {
+					for (int j = halfRes - params.reticleSize / 2; j <= halfRes + params.reticleSize / 2; j += params.bfsSampleSize) {
 						for (auto& offset : bfsOffsets) {
 							if (offset.first < 0 || offset.second < 0) {
 								continue;
@@ -396,31 +1080,102 @@ class vaaac {
 						}
 					}
 				}
-				for (; !q.empty(); ) {
-					std::pair<int, int> xy = q.front();
-					int x = xy.first, y = xy.second;
-					q.pop();
-					if (x < 0 || y < 0 || x + BFS_SAMPLE_SIZE > res || y + BFS_SAMPLE_SIZE > res || visited[x][y]) continue;
-					visited[x][y] = true;
-					if (cv::mean(mask(cv::Rect(x, y, BFS_SAMPLE_SIZE, BFS_SAMPLE_SIZE)))[0] == 0) continue;
-					/*
-					 * update furthermost point coordinates.
-					 * works because the bfs algorithm always
-					 * visits the furthermost element in the
-					 * last place
-					 */
-					xAim = x;
-					yAim = y;
-					// update found object area bounds
-					xMin = std::min(xMin, x);
-					yMin = std::min(yMin, y);
-					xMax = std::max(xMax, x);
-					yMax = std::max(yMax, y);
-					// add neighbors to queue
-					for (auto& offset : bfsOffsets) {
-						q.push(std::make_pair<int, int>(x + offset.first, y + offset.second));
+				/*
+				 * furthest node, the top left one of the
+				 * last level, so that picking it doesn't
+				 * depend on the order of the queue
+				 */
+				int xTip = halfRes, yTip = halfRes;
+				int tipLevel = -1;
+				// one level of the bfs (geodesic distance to the reticle) per iteration
+				for (int level = 0; !q.empty(); ++level) {
+					for (size_t n = q.size(); n > 0; --n) {
+						std::pair<int, int> xy = q.front();
+						int x = xy.first, y = xy.second;
+						q.pop();
+						if (x < 0 || y < 0 || x + params.bfsSampleSize > res || y + params.bfsSampleSize > res || bfsLevels(y, x) != -1) continue;
+						++visitedNodes;
+						bfsVisited.push_back(xy);
+						if (cv::mean(mask(cv::Rect(x, y, params.bfsSampleSize, params.bfsSampleSize)))[0] == 0) {
+							bfsLevels(y, x) = -2;
+							continue;
+						}
+						bfsLevels(y, x) = level;
+						/*
+						 * update furthermost point coordinates.
+						 * works because the bfs algorithm always
+						 * visits the furthermost element in the
+						 * last place
+						 */
+						xAim = x;
+						yAim = y;
+						if (level > tipLevel || y < yTip || (y == yTip && x < xTip)) {
+							xTip = x;
+							yTip = y;
+							tipLevel = level;
+						}
+						// update found object area bounds
+						xMin = std::min(xMin, x);
+						yMin = std::min(yMin, y);
+						xMax = std::max(xMax, x);
+						yMax = std::max(yMax, y);
+						// add neighbors to queue
+						for (auto& offset : bfsOffsets) {
+							q.push(std::make_pair<int, int>(x + offset.first, y + offset.second));
+						}
 					}
 				}
+				/*
+				 * sum of x, sum of y and node count of
+				 * the tip: the nodes of the last
+				 * 'fingertipLevels' levels connected to
+				 * the furthest node through them.
+				 * the level of every node doesn't depend
+				 * on the order it was queued in, so
+				 * neither does the tip
+				 */
+				cv::Vec3d sum(0.0, 0.0, 0.0);
+				if (params.aimEstimator == AIM_GEODESIC_EXTREME && tipLevel >= 0) {
+					int firstTipLevel = std::max(0, tipLevel - params.fingertipLevels + 1);
+					bfsLevels(yTip, xTip) = -2;
+					q.push({ xTip, yTip });
+					for (; !q.empty(); ) {
+						std::pair<int, int> xy = q.front();
+						int x = xy.first, y = xy.second;
+						q.pop();
+						sum += cv::Vec3d(x, y, 1.0);
+						for (auto& offset : bfsOffsets) {
+							int xNext = x + offset.first, yNext = y + offset.second;
+							if (xNext < 0 || yNext < 0 || xNext > res || yNext > res || bfsLevels(yNext, xNext) < firstTipLevel) continue;
+							// counted once
+							bfsLevels(yNext, xNext) = -2;
+							q.push({ xNext, yNext });
+						}
+					}
+				}
+				// ready for the next frame
+				for (auto& xy : bfsVisited) {
+					bfsLevels(xy.second, xy.first) = -1;
+				}
+				bfsVisited.clear();
+				/*
+				 * nodes are sampled by their top left
+				 * corner. only the angle lookup aims at
+				 * their center: 'xAim' and 'yAim' stay
+				 * on the corner, so the no aim area and
+				 * the trigger see the same points for
+				 * both estimators
+				 */
+				double nodeCenter = tipLevel >= 0 ? (params.bfsSampleSize - 1) / 2.0 : 0.0;
+				if (sum[2] > 0.0) {
+					xAim = (int)std::round(sum[0] / sum[2]);
+					yAim = (int)std::round(sum[1] / sum[2]);
+					xAimSubpixel = sum[0] / sum[2] + nodeCenter;
+					yAimSubpixel = sum[1] / sum[2] + nodeCenter;
+				} else {
+					xAimSubpixel = xAim + nodeCenter;
+					yAimSubpixel = yAim + nodeCenter;
+				}
 				/*
 				 * check if aim point falls within
 				 * the no aim area boundaries.
@@ -430,6 +1185,8 @@ class vaaac {
 				if (noAimAreaBounds.contains(cv::Point(xAim, yAim))) {
 					yAim = halfRes;
 					xAim = halfRes;
+					yAimSubpixel = halfRes;
+					xAimSubpixel = halfRes;
 				}
 				/*
 				 * check if there's a clear peak in
@@ -465,23 +1222,27 @@ class vaaac {
 							triggered = true;
 							yAim = left.first;
 							xAim = left.second;
+							yAimSubpixel = yAim + nodeCenter;
+							xAimSubpixel = xAim + nodeCenter;
 						}
 						increment = true;
 						yxDelta.clear();
 					}
 				}
 				// make angles
-				yAngle = -(double)(halfRes - yAim) / halfRes * 90.0;
-				xAngle = -(double)(halfRes - xAim) / halfRes * 90.0;
-				yAngleSmooth += (yAngle - yAngleSmooth) / (double)(AIM_SMOOTHNESS);
-				xAngleSmooth += (xAngle - xAngleSmooth) / (double)(AIM_SMOOTHNESS);
+				yAngle = lookupAngle(yAngleLut, xAimSubpixel, yAimSubpixel);
+				xAngle = lookupAngle(xAngleLut, xAimSubpixel, yAimSubpixel);
+				yAngleSmooth += (yAngle - yAngleSmooth) / (double)(params.aimSmoothness);
+				xAngleSmooth += (xAngle - xAngleSmooth) / (double)(params.aimSmoothness);
+				// keep the background model from learning the object
+				objectBounds = cv::Rect(xMin, yMin, xMax - xMin + params.bfsSampleSize, yMax - yMin + params.bfsSampleSize);
 				/*Fyx
 				 * cut out everything outside of the
 				 * object boundaries
 				 */
 				mask(cv::Rect(0, 0, xMin, res)).setTo(cv::Scalar(0));
 				mask(cv::Rect(xMin, 0, res - xMin, yMin)).setTo(cv::Scalar(0));
-				mask(cv::Rect(xMin, yMax, res - xMin, height - yMax)).setTo(cv::Scalar(0));
+				mask(cv::Rect(xMin, yMax, res - xMin, res - yMax)).setTo(cv::Scalar(0));
 				mask(cv::Rect(xMax, yMin, res - xMax, yMax - yMin)).setTo(cv::Scalar(0));
 			}
 
@@ -489,7 +1250,7 @@ class vaaac {
 			//-------- r e n d e r i n g --------//
 			//                                   //
 
-			if (RENDER_TO_FRAME) {
+			if (params.renderToFrame) {
 				/*
 				 * draw rectangle indicating either
 				 * the reticle bounds or
@@ -523,7 +1284,7 @@ class vaaac {
 				// mix frame with mask
 				cv::addWeighted(mask, 0.5, frame, 1.0, 0.0, frame);
 				// present final image
-				if (RENDER_TO_WINDOW) {
+				if (params.renderToWindow) {
 					cv::imshow("update", frame);
 				}
 			}
@@ -0,0 +1,266 @@
+/*
+ * MIT License
+ * Copyright (c) 2020 Pablo Peñarroja
+ */
+
+/*
+ * offline analysis for vaaac.
+ * runs the detection pipeline over
+ * recorded clips, once per parameter
+ * set, and measures how it did.
+ * every run gets its own pipeline, so
+ * the runs are spread over all the
+ * cores.
+ *
+ * clips are expected to start in the
+ * calibration pose: the skin tone is
+ * sampled from the center of their
+ * first frame.
+ *
+ * a clip can be annotated with a csv
+ * file next to it, named like the clip
+ * plus '.csv', with one line per frame
+ * in which the arm is visible:
+ *
+ *   frame,xAngle,yAngle,triggered
+ *
+ * frames are counted from zero, and
+ * 'triggered' is either 0 or 1
+ */
+
+ //                                   //
+ //-------- c o n s t a n t s --------//
+ //                                   //
+
+/*
+ * a detected trigger counts as a hit if
+ * it's at most this many frames away
+ * from an annotated one
+ */
+const int BATCH_TRIGGER_TOLERANCE = 5;
+
+//                               //
+//-------- b  a  t  c  h --------//
+//                               //
+
+#pragma once
+
+#include "vaaac.hpp"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+
+struct vaaacBatchTask {
+	std::string clip;
+	vaaacParams params;
+};
+
+struct vaaacBatchResult {
+	// whether the clip could be read and run through the pipeline
+	bool ok = false;
+
+	// frame counts
+	int frames = 0;
+	int detectedFrames = 0;
+	int triggers = 0;
+
+	// update() wall time (milliseconds)
+	double meanUpdateTime = 0.0;
+	double maxUpdateTime = 0.0;
+
+	// bfs workload
+	double meanVisitedNodes = 0.0;
+
+	/*
+	 * mean change of the angles from one
+	 * detected frame to the next.
+	 * on clips of an arm held still, this
+	 * is pure jitter.
+	 * measured on the raw angles, so that it
+	 * compares the aim estimators and not
+	 * the smoothing
+	 */
+	double angleJitter = 0.0;
+
+	// only filled in for annotated clips
+	bool annotated = false;
+	double meanAngleError = 0.0;
+	int triggerHits = 0;
+	int triggerMisses = 0;
+	int triggerFalseAlarms = 0;
+};
+
+class vaaacBatch {
+
+	private:
+
+		struct annotation {
+			double xAngle;
+			double yAngle;
+			bool triggered;
+		};
+
+		static std::map<int, annotation> loadAnnotations(const std::string& clip) {
+			std::map<int, annotation> annotations;
+			std::ifstream file(clip + ".csv");
+			std::string line;
+			for (; std::getline(file, line); ) {
+				std::istringstream ss(line);
+				int frame, triggered;
+				annotation a;
+				char comma;
+				if (ss >> frame >> comma >> a.xAngle >> comma >> a.yAngle >> comma >> triggered) {
+					a.triggered = triggered != 0;
+					annotations[frame] = a;
+				}
+			}
+			return annotations;
+		}
+
+	public:
+
+		/*
+		 * runs one task on the calling thread.
+		 * opencv errors, such as a clip whose
+		 * frame size changes halfway, only fail
+		 * this run
+		 */
+		static vaaacBatchResult runClip(const vaaacBatchTask& task) {
+			vaaacBatchResult result;
+			try {
+				if (!task.params.isValid()) {
+					return result;
+				}
+				cv::VideoCapture clip(task.clip);
+				cv::Mat input;
+				if (!clip.isOpened() || !clip.read(input)) {
+					return result;
+				}
+				// nobody is looking
+				vaaacParams params = task.params;
+				params.renderToFrame = false;
+				params.renderToWindow = false;
+				// fails if the sizes don't fit in the clip's viewport
+				vaaac v(input.cols, input.rows, params);
+				v.calibrateSkinTone(input);
+				if (!v.isOk()) {
+					return result;
+				}
+				result.ok = true;
+				std::map<int, annotation> annotations = loadAnnotations(task.clip);
+				result.annotated = !annotations.empty();
+				std::vector<int> detectedTriggers;
+				double lastXAngle = 0.0, lastYAngle = 0.0;
+				bool lastDetected = false;
+				int jitterSamples = 0, errorSamples = 0;
+				for (int i = 1; clip.read(input); ++i) {
+					auto begin = std::chrono::steady_clock::now();
+					v.update(input);
+					double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+					++result.frames;
+					result.meanUpdateTime += elapsed;
+					result.maxUpdateTime = std::max(result.maxUpdateTime, elapsed);
+					result.meanVisitedNodes += v.getVisitedNodes();
+					if (v.isTriggered()) {
+						++result.triggers;
+						detectedTriggers.push_back(i);
+					}
+					if (!v.isDetected()) {
+						lastDetected = false;
+						continue;
+					}
+					++result.detectedFrames;
+					if (lastDetected) {
+						result.angleJitter += std::abs(v.getRawXAngle() - lastXAngle) + std::abs(v.getRawYAngle() - lastYAngle);
+						++jitterSamples;
+					}
+					lastDetected = true;
+					lastXAngle = v.getRawXAngle();
+					lastYAngle = v.getRawYAngle();
+					auto it = annotations.find(i);
+					if (it != annotations.end()) {
+						result.meanAngleError += std::abs(v.getXAngle() - it->second.xAngle) + std::abs(v.getYAngle() - it->second.yAngle);
+						++errorSamples;
+					}
+				}
+				if (result.frames) {
+					result.meanUpdateTime /= result.frames;
+					result.meanVisitedNodes /= result.frames;
+				}
+				if (jitterSamples) {
+					result.angleJitter /= jitterSamples;
+				}
+				if (errorSamples) {
+					result.meanAngleError /= errorSamples;
+				}
+				// match annotated triggers to detected ones
+				std::vector<bool> matched(detectedTriggers.size(), false);
+				for (auto& a : annotations) {
+					if (!a.second.triggered) {
+						continue;
+					}
+					bool hit = false;
+					for (int j = 0; j < (int)detectedTriggers.size() && !hit; ++j) {
+						if (!matched[j] && std::abs(detectedTriggers[j] - a.first) <= BATCH_TRIGGER_TOLERANCE) {
+							matched[j] = true;
+							hit = true;
+						}
+					}
+					if (hit) {
+						++result.triggerHits;
+					} else {
+						++result.triggerMisses;
+					}
+				}
+				if (result.annotated) {
+					for (bool m : matched) {
+						result.triggerFalseAlarms += !m;
+					}
+				}
+				return result;
+			} catch (const cv::Exception&) {
+				return vaaacBatchResult();
+			}
+		}
+
+		/*
+		 * runs every task and returns their
+		 * results in the same order.
+		 * 'threads' defaults to the number of
+		 * cores
+		 */
+		static std::vector<vaaacBatchResult> run(const std::vector<vaaacBatchTask>& tasks, int threads = 0) {
+			std::vector<vaaacBatchResult> results(tasks.size());
+			if (threads <= 0) {
+				threads = std::max(1, (int)std::thread::hardware_concurrency());
+			}
+			threads = std::min(threads, (int)tasks.size());
+			/*
+			 * one pipeline per core already keeps
+			 * the machine busy, opencv's own
+			 * threads would only get in the way
+			 */
+			int cvThreads = cv::getNumThreads();
+			cv::setNumThreads(1);
+			std::atomic<size_t> next(0);
+			std::vector<std::thread> workers;
+			for (int i = 0; i < threads; ++i) {
+				workers.emplace_back([&]() {
+					for (size_t task; (task = next++) < tasks.size(); ) {
+						results[task] = runClip(tasks[task]);
+					}
+				});
+			}
+			for (auto& worker : workers) {
+				worker.join();
+			}
+			cv::setNumThreads(cvThreads);
+			return results;
+		}
+};
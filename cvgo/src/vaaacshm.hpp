@@ -0,0 +1,520 @@
+/*
+ * MIT License
+ * Copyright (c) 2020 Pablo Peñarroja
+ */
+
+/*
+ * shared memory publication of vaaac's
+ * results, so that other processes on
+ * the same machine (overlays, loggers,
+ * monitoring...) can read them at their
+ * own pace.
+ *
+ * the tracking loop is the only writer
+ * and never waits on readers: the state
+ * block and every slot of the frame
+ * ring are protected by a sequence lock.
+ * a reader retries, or drops the frame,
+ * when the writer got in the way.
+ *
+ * only one publisher owns a block at a
+ * time. the owner holds a lock that the
+ * system releases if it dies, so a new
+ * publisher can take over the block it
+ * left behind. readers notice a closed
+ * or taken over block with
+ * 'isAttached()', and then have to be
+ * created again.
+ *
+ * this header doesn't depend on opencv,
+ * so readers only need to include it
+ */
+
+ //                                   //
+ //-------- c o n s t a n t s --------//
+ //                                   //
+
+/*
+ * name of the shared memory block
+ * published by cvgo. tools that publish
+ * their own blocks (tests...) should
+ * pick another one
+ */
+#ifdef _WIN32
+typedef const wchar_t* vaaacShmName;
+const vaaacShmName SHM_NAME = L"Local\\vaaac";
+#else
+typedef const char* vaaacShmName;
+const vaaacShmName SHM_NAME = "/vaaac";
+#endif
+
+/*
+ * number of frames kept in the ring.
+ * a reader working on a frame in place
+ * has this many updates to finish
+ * before the frame gets overwritten
+ */
+const int SHM_FRAME_SLOTS = 4;
+
+//                         //
+//-------- s h m --------//
+//                         //
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+
+#ifdef _WIN32
+#include <string>
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#endif
+
+/*
+ * the sequence counters live in memory
+ * mapped by several processes, which is
+ * only fine if they don't hide a lock
+ */
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "vaaacshm requires lock free 32 bit atomics");
+
+const uint32_t SHM_MAGIC = 0x63616176;
+const uint32_t SHM_VERSION = 1;
+
+// snapshot of the tracking loop, published once per update()
+struct vaaacShmState {
+	uint32_t update;
+	uint32_t detected;
+	uint32_t triggered;
+	uint32_t visitedNodes;
+	double xAngle;
+	double yAngle;
+	// milliseconds
+	double updateTime;
+	double captureInterval;
+	double captureJitter;
+};
+
+struct vaaacShmHeader {
+	/*
+	 * bumped by every publisher that takes
+	 * the block over, and set to closed by
+	 * the one that owns it when it's done
+	 */
+	std::atomic<uint32_t> generation;
+	std::atomic<uint32_t> closed;
+
+	// written once per publisher, before 'magic'
+	uint32_t version;
+	uint32_t width;
+	uint32_t height;
+	uint32_t frameSlots;
+	uint32_t frameSize;
+	std::atomic<uint32_t> magic;
+
+	// state block
+	std::atomic<uint32_t> stateSeq;
+	vaaacShmState state;
+
+	/*
+	 * frame ring: frame n lives in slot
+	 * n % frameSlots.
+	 * 'latestFrame' is the number of the
+	 * last complete one, zero if none.
+	 * 'frameNumber' is the number of the
+	 * frame held by each slot, written under
+	 * the slot's sequence lock
+	 */
+	std::atomic<uint32_t> latestFrame;
+	std::atomic<uint32_t> frameSeq[SHM_FRAME_SLOTS];
+	std::atomic<uint32_t> frameNumber[SHM_FRAME_SLOTS];
+};
+
+// a frame being read in place
+struct vaaacShmFrame {
+	const unsigned char* data;
+	uint32_t width;
+	uint32_t height;
+	uint32_t number;
+	uint32_t seq;
+};
+
+/*
+ * maps and unmaps the block.
+ * the writer creates it, or takes it
+ * over, and readers only open it
+ */
+class vaaacShmMapping {
+
+	protected:
+
+		void* base;
+		size_t size;
+#ifdef _WIN32
+		HANDLE handle;
+		// named mutex held by the owner
+		HANDLE owner;
+#else
+		// the owner holds an exclusive flock on it
+		int fd;
+#endif
+
+		vaaacShmMapping() : base(nullptr), size(0) {
+#ifdef _WIN32
+			handle = NULL;
+			owner = NULL;
+#else
+			fd = -1;
+#endif
+		}
+
+		~vaaacShmMapping() {
+#ifdef _WIN32
+			if (base) UnmapViewOfFile(base);
+			if (handle) CloseHandle(handle);
+			if (owner) {
+				ReleaseMutex(owner);
+				CloseHandle(owner);
+			}
+#else
+			if (base) munmap(base, size);
+			if (fd != -1) close(fd);
+#endif
+		}
+
+		/*
+		 * creates the block, or opens the one a
+		 * publisher that's gone left behind.
+		 * fails if a live publisher owns it
+		 */
+		bool create(vaaacShmName name, size_t bytes) {
+#ifdef _WIN32
+			// abandoned, not held, when its owner dies
+			owner = CreateMutexW(NULL, FALSE, (std::wstring(name) + L".owner").c_str());
+			if (!owner) return false;
+			DWORD wait = WaitForSingleObject(owner, 0);
+			if (wait != WAIT_OBJECT_0 && wait != WAIT_ABANDONED) {
+				CloseHandle(owner);
+				owner = NULL;
+				return false;
+			}
+			handle = CreateFileMappingW(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, (DWORD)bytes, name);
+			if (!handle) return false;
+			base = MapViewOfFile(handle, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+			// a block kept alive by readers can't grow
+			MEMORY_BASIC_INFORMATION mbi;
+			if (!base || !VirtualQuery(base, &mbi, sizeof(mbi)) || mbi.RegionSize < bytes) return false;
+#else
+			fd = shm_open(name, O_CREAT | O_RDWR, 0600);
+			if (fd == -1) return false;
+			// released by the kernel when its owner dies
+			if (flock(fd, LOCK_EX | LOCK_NB) == -1) {
+				close(fd);
+				fd = -1;
+				return false;
+			}
+			// never shrunk, readers may still map all of it
+			struct stat st;
+			if (fstat(fd, &st) == -1) return false;
+			if ((size_t)st.st_size < bytes && ftruncate(fd, bytes) == -1) return false;
+			base = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			if (base == MAP_FAILED) base = nullptr;
+#endif
+			size = bytes;
+			return base != nullptr;
+		}
+
+		bool open(vaaacShmName name) {
+#ifdef _WIN32
+			handle = OpenFileMappingW(FILE_MAP_READ, FALSE, name);
+			if (!handle) return false;
+			base = MapViewOfFile(handle, FILE_MAP_READ, 0, 0, 0);
+			MEMORY_BASIC_INFORMATION mbi;
+			if (base && VirtualQuery(base, &mbi, sizeof(mbi))) size = mbi.RegionSize;
+#else
+			fd = shm_open(name, O_RDONLY, 0);
+			struct stat st;
+			if (fd == -1 || fstat(fd, &st) == -1) return false;
+			size = st.st_size;
+			base = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+			if (base == MAP_FAILED) base = nullptr;
+#endif
+			return base != nullptr && size >= sizeof(vaaacShmHeader);
+		}
+
+		inline vaaacShmHeader* header() {
+			return (vaaacShmHeader*)base;
+		}
+
+		// frames are laid out right after the header, cache line aligned
+		inline static size_t frameOffset(uint32_t slot, uint32_t frameSize) {
+			size_t headerSize = (sizeof(vaaacShmHeader) + 63) & ~(size_t)63;
+			size_t slotSize = ((size_t)frameSize + 63) & ~(size_t)63;
+			return headerSize + slot * slotSize;
+		}
+
+		// moves a sequence to the next even value, failing the reads in flight
+		inline static void skipSequence(std::atomic<uint32_t>& seq) {
+			seq.store((seq.load(std::memory_order_relaxed) | 1) + 1, std::memory_order_relaxed);
+		}
+};
+
+/*
+ * writer side, owned by the tracking
+ * loop.
+ * frames are 3 channel, 8 bit images of
+ * the given size
+ */
+class vaaacShmPublisher : private vaaacShmMapping {
+
+	private:
+
+		bool ok;
+		uint32_t frames;
+#ifndef _WIN32
+		vaaacShmName name;
+#endif
+
+	public:
+
+		inline bool isOk() {
+			return ok;
+		}
+
+		/*
+		 * fails if another publisher is alive.
+		 * a block left behind by one that isn't
+		 * is reinitialised in place
+		 */
+		vaaacShmPublisher(int width, int height, vaaacShmName name = SHM_NAME) : frames(0) {
+#ifndef _WIN32
+			this->name = name;
+#endif
+			uint32_t frameSize = width * height * 3;
+			ok = create(name, frameOffset(SHM_FRAME_SLOTS, frameSize));
+			if (!ok) {
+				return;
+			}
+			/*
+			 * readers of the previous publisher see
+			 * the new generation before anything else
+			 * changes. the sequences keep counting
+			 * from where it left them, so the reads
+			 * it had in flight fail
+			 */
+			vaaacShmHeader* h = header();
+			h->magic.store(0, std::memory_order_relaxed);
+			h->generation.store(h->generation.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			h->closed.store(0, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			skipSequence(h->stateSeq);
+			for (int i = 0; i < SHM_FRAME_SLOTS; ++i) {
+				skipSequence(h->frameSeq[i]);
+				h->frameNumber[i].store(0, std::memory_order_relaxed);
+			}
+			h->latestFrame.store(0, std::memory_order_relaxed);
+			h->version = SHM_VERSION;
+			h->width = width;
+			h->height = height;
+			h->frameSlots = SHM_FRAME_SLOTS;
+			h->frameSize = frameSize;
+			std::memset(&h->state, 0, sizeof(h->state));
+			h->magic.store(SHM_MAGIC, std::memory_order_release);
+		}
+
+		~vaaacShmPublisher() {
+			if (!ok) {
+				return;
+			}
+			header()->closed.store(1, std::memory_order_release);
+#ifndef _WIN32
+			// still the owner, so nobody else is using the name
+			shm_unlink(name);
+#endif
+		}
+
+		void publishState(const vaaacShmState& state) {
+			if (!ok) {
+				return;
+			}
+			vaaacShmHeader* h = header();
+			uint32_t seq = h->stateSeq.load(std::memory_order_relaxed);
+			// odd: write in progress
+			h->stateSeq.store(seq + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			h->state = state;
+			h->stateSeq.store(seq + 2, std::memory_order_release);
+		}
+
+		/*
+		 * copies a frame into the next slot of
+		 * the ring.
+		 * 'step' is the distance in bytes from
+		 * one row to the next
+		 */
+		void publishFrame(const unsigned char* data, size_t step) {
+			if (!ok) {
+				return;
+			}
+			vaaacShmHeader* h = header();
+			uint32_t number = ++frames;
+			uint32_t slot = number % SHM_FRAME_SLOTS;
+			unsigned char* dst = (unsigned char*)base + frameOffset(slot, h->frameSize);
+			size_t rowSize = (size_t)h->width * 3;
+			uint32_t seq = h->frameSeq[slot].load(std::memory_order_relaxed);
+			h->frameSeq[slot].store(seq + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			h->frameNumber[slot].store(number, std::memory_order_relaxed);
+			if (step == rowSize) {
+				std::memcpy(dst, data, rowSize * h->height);
+			} else {
+				for (uint32_t y = 0; y < h->height; ++y) {
+					std::memcpy(dst + y * rowSize, data + y * step, rowSize);
+				}
+			}
+			h->frameSeq[slot].store(seq + 2, std::memory_order_release);
+			h->latestFrame.store(number, std::memory_order_release);
+		}
+};
+
+/*
+ * reader side.
+ * never writes to the block, so any
+ * number of readers can attach
+ */
+class vaaacShmReader : private vaaacShmMapping {
+
+	private:
+
+		bool ok;
+
+		/*
+		 * the publisher attached to and its
+		 * layout, which a later one may change
+		 */
+		uint32_t generation;
+		uint32_t width;
+		uint32_t height;
+		uint32_t frameSize;
+
+	public:
+
+		inline bool isOk() {
+			return ok;
+		}
+
+		vaaacShmReader(vaaacShmName name = SHM_NAME) {
+			ok = open(name);
+			if (!ok) {
+				return;
+			}
+			vaaacShmHeader* h = header();
+			ok = h->magic.load(std::memory_order_acquire) == SHM_MAGIC
+				&& h->version == SHM_VERSION
+				&& h->frameSlots == SHM_FRAME_SLOTS;
+			if (!ok) {
+				return;
+			}
+			generation = h->generation.load(std::memory_order_relaxed);
+			width = h->width;
+			height = h->height;
+			frameSize = h->frameSize;
+			ok = size >= frameOffset(SHM_FRAME_SLOTS, frameSize) && isAttached();
+		}
+
+		/*
+		 * whether the publisher this reader
+		 * attached to is still publishing.
+		 * once it's closed or taken over, reads
+		 * fail, and a new reader has to be
+		 * created to follow the next publisher.
+		 * a publisher that died without being
+		 * replaced leaves the block attached,
+		 * but its 'update' counter stops
+		 */
+		bool isAttached() {
+			vaaacShmHeader* h = header();
+			return ok && h->magic.load(std::memory_order_acquire) == SHM_MAGIC
+				&& h->generation.load(std::memory_order_relaxed) == generation
+				&& !h->closed.load(std::memory_order_relaxed);
+		}
+
+		/*
+		 * copies the latest state out.
+		 * false if the writer kept getting in
+		 * the way for 'retries' attempts
+		 */
+		bool readState(vaaacShmState& state, int retries = 100) {
+			if (!ok) {
+				return false;
+			}
+			vaaacShmHeader* h = header();
+			for (int i = 0; i < retries; ++i) {
+				uint32_t before = h->stateSeq.load(std::memory_order_acquire);
+				if (before & 1) {
+					continue;
+				}
+				state = h->state;
+				std::atomic_thread_fence(std::memory_order_acquire);
+				uint32_t after = h->stateSeq.load(std::memory_order_relaxed);
+				if (before == after) {
+					return isAttached();
+				}
+			}
+			return false;
+		}
+
+		/*
+		 * points 'frame' at the latest frame,
+		 * without copying it.
+		 * once done with it, 'isValid(frame)'
+		 * tells whether the writer overwrote
+		 * it in the meantime, in which case
+		 * whatever was read must be discarded
+		 */
+		bool acquireFrame(vaaacShmFrame& frame) {
+			if (!ok) {
+				return false;
+			}
+			vaaacShmHeader* h = header();
+			frame.number = h->latestFrame.load(std::memory_order_acquire);
+			if (!frame.number) {
+				return false;
+			}
+			uint32_t slot = frame.number % SHM_FRAME_SLOTS;
+			frame.seq = h->frameSeq[slot].load(std::memory_order_acquire);
+			if (frame.seq & 1) {
+				return false;
+			}
+			// after the sequence, which a takeover moves after bumping the generation
+			if (!isAttached()) {
+				return false;
+			}
+			/*
+			 * the writer may have lapped the ring
+			 * since 'latestFrame' was read. the
+			 * slot's own number is covered by the
+			 * sequence lock, so 'isValid()' also
+			 * vouches for it
+			 */
+			if (h->frameNumber[slot].load(std::memory_order_relaxed) != frame.number) {
+				return false;
+			}
+			frame.data = (const unsigned char*)base + frameOffset(slot, frameSize);
+			frame.width = width;
+			frame.height = height;
+			return true;
+		}
+
+		bool isValid(const vaaacShmFrame& frame) {
+			std::atomic_thread_fence(std::memory_order_acquire);
+			return header()->frameSeq[frame.number % SHM_FRAME_SLOTS].load(std::memory_order_relaxed) == frame.seq;
+		}
+};
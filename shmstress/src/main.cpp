@@ -0,0 +1,171 @@
+#include "vaaacshm.hpp"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+
+#ifndef _WIN32
+#include <sys/wait.h>
+#endif
+
+/*
+ * torn read stress test for vaaacshm.
+ *
+ *   shmstress
+ *
+ * publishes states and frames as fast as
+ * possible while a reader process (this
+ * same program, run with '--reader')
+ * checks every field of every state and
+ * every byte of every frame it reads
+ * against the writer's counter.
+ * exits with 1 on any torn read or if a
+ * second publisher could take the block
+ * over, and with 2 if the test couldn't
+ * run or the reader didn't get to check
+ * both states and frames.
+ * it uses its own block, so it can run
+ * next to cvgo
+ */
+
+#ifdef _WIN32
+const vaaacShmName STRESS_SHM_NAME = L"Local\\vaaac-shmstress";
+#else
+const vaaacShmName STRESS_SHM_NAME = "/vaaac-shmstress";
+#endif
+
+const int STRESS_RESOLUTION = 240;
+const int STRESS_SECONDS = 5;
+
+/*
+ * one frame is published every this many
+ * states, so that the reader gets to
+ * finish some frames before the ring
+ * laps it
+ */
+const int STRESS_STATES_PER_FRAME = 64;
+
+// fills a state with nothing but the counter
+vaaacShmState makeState(uint32_t update) {
+	vaaacShmState state;
+	state.update = update;
+	state.detected = update;
+	state.triggered = update;
+	state.visitedNodes = update;
+	state.xAngle = update;
+	state.yAngle = update;
+	state.updateTime = update;
+	state.captureInterval = update;
+	state.captureJitter = update;
+	return state;
+}
+
+// whether every field of the state holds the same counter
+bool isWhole(const vaaacShmState& state) {
+	uint32_t n = state.update;
+	return state.detected == n && state.triggered == n && state.visitedNodes == n
+		&& state.xAngle == n && state.yAngle == n && state.updateTime == n
+		&& state.captureInterval == n && state.captureJitter == n;
+}
+
+int reader() {
+	// the writer creates the block before launching the reader
+	vaaacShmReader shm(STRESS_SHM_NAME);
+	if (!shm.isOk()) {
+		std::cout << "[-] reader couldn't attach." << std::endl;
+		return 2;
+	}
+	long states = 0, frames = 0, dropped = 0, torn = 0;
+	std::vector<unsigned char> copy(STRESS_RESOLUTION * STRESS_RESOLUTION * 3);
+	auto end = std::chrono::steady_clock::now() + std::chrono::seconds(STRESS_SECONDS);
+	for (; std::chrono::steady_clock::now() < end; ) {
+		vaaacShmState state;
+		if (shm.readState(state)) {
+			++states;
+			if (!isWhole(state)) {
+				++torn;
+			}
+		}
+		vaaacShmFrame frame;
+		if (shm.acquireFrame(frame)) {
+			std::memcpy(copy.data(), frame.data, copy.size());
+			if (!shm.isValid(frame)) {
+				++dropped;
+				continue;
+			}
+			++frames;
+			// every byte holds the frame number, which also catches mislabelled frames
+			for (unsigned char byte : copy) {
+				if (byte != (unsigned char)frame.number) {
+					++torn;
+					break;
+				}
+			}
+		}
+	}
+	std::cout << "[+] states: " << states << ", frames: " << frames << ", dropped: " << dropped << ", torn: " << torn << "." << std::endl;
+	if (torn) {
+		return 1;
+	}
+	return states && frames ? 0 : 2;
+}
+
+int writer(const char* self) {
+	vaaacShmPublisher shm(STRESS_RESOLUTION, STRESS_RESOLUTION, STRESS_SHM_NAME);
+	if (!shm.isOk()) {
+		std::cout << "[-] couldn't create the shared memory block." << std::endl;
+		return 2;
+	}
+	/*
+	 * the block is owned while the first
+	 * publisher is alive. tried from another
+	 * thread, since a windows mutex lets its
+	 * owner thread in again
+	 */
+	bool tookOver = false;
+	std::thread([&]() {
+		vaaacShmPublisher second(STRESS_RESOLUTION, STRESS_RESOLUTION, STRESS_SHM_NAME);
+		tookOver = second.isOk();
+	}).join();
+	if (tookOver) {
+		std::cout << "[-] a second publisher took the block over." << std::endl;
+		return 1;
+	}
+	// the reader is a separate process, launched from another thread
+	std::atomic<bool> done(false);
+	int result = 2;
+	std::thread launcher([&]() {
+		std::string command = std::string("\"") + self + "\" --reader";
+		int status = std::system(command.c_str());
+#ifndef _WIN32
+		status = WIFEXITED(status) ? WEXITSTATUS(status) : 2;
+#endif
+		result = status;
+		done = true;
+	});
+	std::vector<unsigned char> image(STRESS_RESOLUTION * STRESS_RESOLUTION * 3);
+	size_t step = STRESS_RESOLUTION * 3;
+	for (uint32_t update = 1, frame = 1; !done; ++update) {
+		vaaacShmState state = makeState(update);
+		shm.publishState(state);
+		// publishFrame() numbers frames itself, starting at one
+		if (update % STRESS_STATES_PER_FRAME == 0) {
+			std::memset(image.data(), (unsigned char)frame++, image.size());
+			shm.publishFrame(image.data(), step);
+		}
+	}
+	launcher.join();
+	std::cout << (result ? "[-] failed." : "[+] passed.") << std::endl;
+	return result;
+}
+
+int main(int argc, char* argv[]) {
+	if (argc > 1 && std::string(argv[1]) == "--reader") {
+		return reader();
+	}
+	return writer(argv[0]);
+}